@@ -0,0 +1,48 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "commandserve.hpp"
+#include "rpmpackage.hpp"
+#include "server.hpp"
+
+void CommandServe::init_options(options_description &cmd_desc,
+                                positional_options_description &cmd_pos)
+{
+    namespace po = boost::program_options;
+    cmd_desc.add_options()
+    ("socket", po::value<std::string>()->default_value("pkgfs.sock"),
+     "Unix domain socket to listen on")
+    ("packages", po::value<std::vector<std::string>>(), "Packages to serve");
+    cmd_pos.add("packages", -1);
+}
+
+int CommandServe::run(const variables_map &vm) const {
+    if (vm.count("packages") == 0)
+        throw boost::program_options::required_option("packages");
+    Server::catalog packages;
+    for (const std::string &filename:
+         vm["packages"].as<std::vector<std::string>>()) {
+        std::unique_ptr<RpmPackage> pkg{new RpmPackage(filename)};
+        const std::string nvra = pkg->nvra();
+        if (!packages.emplace(nvra, std::move(pkg)).second)
+            std::cerr << "Skipping " << filename << ": package " << nvra
+                      << " is already loaded\n";
+    }
+    std::size_t files = 0, file_bytes = 0;
+    for (const Server::catalog::value_type &p: packages) {
+        files += p.second->files().size();
+        file_bytes += p.second->files().memory_usage();
+    }
+    Server server(packages, vm["socket"].as<std::string>());
+    std::cerr << "Serving " << packages.size() << " packages with "
+              << files << " files (" << file_bytes
+              << " bytes of file tables) on "
+              << vm["socket"].as<std::string>() << "\n";
+    server.run();
+    return 0;
+}
+
+Command<>::Register CommandServe::reg{CommandServe::cmd_name,
+                                      CommandServe::create};
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+
+#include "filetable.hpp"
+
+namespace {
+
+    void put_varint(std::string &out, boost::uint64_t n)
+    {
+        while (n >= 0x80) {
+            out.push_back(char(n | 0x80));
+            n >>= 7;
+        }
+        out.push_back(char(n));
+    }
+
+    boost::uint64_t get_varint(const char *&p)
+    {
+        boost::uint64_t n = 0;
+        for (unsigned int shift = 0;; shift += 7) {
+            unsigned char c = *p++;
+            n |= boost::uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80))
+                return n;
+        }
+    }
+
+    // Deltas are zigzag coded so that small negative values stay short.
+    void put_delta(std::string &out, boost::uint64_t prev, boost::uint64_t n)
+    {
+        boost::uint64_t d = n - prev;
+        put_varint(out, d >> 63 ? ~(d << 1) : d << 1);
+    }
+
+    boost::uint64_t get_delta(const char *&p, boost::uint64_t prev)
+    {
+        boost::uint64_t z = get_varint(p);
+        return prev + (z & 1 ? ~(z >> 1) : z >> 1);
+    }
+
+    int compare_path(const std::string &path,
+                     const std::string &dir, const std::string &base)
+    {
+        int c = path.compare(0, dir.size(), dir);
+        if (c != 0)
+            return c;
+        return path.compare(dir.size(), std::string::npos, base);
+    }
+}
+
+FileTable::FileTable(const std::vector<std::string> &dirnames,
+                     const std::vector<std::string> &basenames,
+                     const std::vector<boost::uint32_t> &dirindexes,
+                     const std::vector<boost::uint64_t> &sizes,
+                     const std::vector<boost::uint16_t> &modes,
+                     const std::vector<boost::uint32_t> &mtimes)
+: count_(basenames.size()), dirs_(dirnames)
+{
+    if (dirindexes.size() != count_ ||
+        (!sizes.empty() && sizes.size() != count_) ||
+        (!modes.empty() && modes.size() != count_) ||
+        (!mtimes.empty() && mtimes.size() != count_))
+        throw std::invalid_argument("File list is inconsistent");
+    for (boost::uint32_t d: dirindexes)
+        if (d >= dirs_.size())
+            throw std::invalid_argument("File list is inconsistent");
+
+    std::vector<std::size_t> order(count_);
+    std::iota(order.begin(), order.end(), 0);
+    {
+        std::vector<std::string> paths(count_);
+        for (std::size_t i = 0; i < count_; i++)
+            paths[i] = dirs_[dirindexes[i]] + basenames[i];
+        std::sort(order.begin(), order.end(),
+                  [&](std::size_t a, std::size_t b) {
+                      return paths[a] < paths[b];
+                  });
+    }
+
+    std::map<boost::uint16_t, boost::uint32_t> mode_codes;
+    for (boost::uint16_t m: modes)
+        mode_codes.emplace(m, 0);
+    for (auto &m: mode_codes) {
+        m.second = modes_.size();
+        modes_.push_back(m.first);
+    }
+
+    const std::string *prev_base = nullptr;
+    boost::uint64_t prev_size = 0;
+    boost::uint32_t prev_mtime = 0;
+    for (std::size_t i = 0; i < count_; i++) {
+        const std::size_t f = order[i];
+        const std::string &base = basenames[f];
+        std::size_t shared = 0;
+        if (i % block_size == 0) {
+            blocks_.push_back(data_.size());
+            prev_size = 0;
+            prev_mtime = 0;
+        } else {
+            shared = std::mismatch(base.begin(),
+                                   base.begin() +
+                                   std::min(base.size(), prev_base->size()),
+                                   prev_base->begin()).first - base.begin();
+        }
+        put_varint(data_, dirindexes[f]);
+        put_varint(data_, shared);
+        put_varint(data_, base.size() - shared);
+        data_.append(base, shared, std::string::npos);
+        const boost::uint64_t size = sizes.empty() ? 0 : sizes[f];
+        put_delta(data_, prev_size, size);
+        const boost::uint32_t mtime = mtimes.empty() ? 0 : mtimes[f];
+        put_delta(data_, prev_mtime, mtime);
+        if (!modes.empty())
+            put_varint(data_, mode_codes[modes[f]]);
+        prev_base = &base;
+        prev_size = size;
+        prev_mtime = mtime;
+    }
+    data_.shrink_to_fit();
+}
+
+FileTable::Cursor::Cursor(const FileTable &table, std::size_t block)
+: table_(table), p_(table.data_.data() + table.blocks_[block]), dir_(0)
+{
+    file_.size = 0;
+    file_.mtime = 0;
+    file_.mode = 0;
+}
+
+void FileTable::Cursor::next()
+{
+    dir_ = get_varint(p_);
+    base_.resize(get_varint(p_));
+    const std::size_t suffix = get_varint(p_);
+    base_.append(p_, suffix);
+    p_ += suffix;
+    file_.size = get_delta(p_, file_.size);
+    file_.mtime = get_delta(p_, file_.mtime);
+    if (!table_.modes_.empty())
+        file_.mode = table_.modes_[get_varint(p_)];
+}
+
+const FileTable::File &FileTable::Cursor::file()
+{
+    file_.path = dir();
+    file_.path += base_;
+    return file_;
+}
+
+FileTable::File FileTable::operator[](std::size_t i) const
+{
+    Cursor c(*this, i / block_size);
+    for (std::size_t j = 0; j <= i % block_size; j++)
+        c.next();
+    return c.file();
+}
+
+int FileTable::compare(std::size_t block, const std::string &path) const
+{
+    Cursor c(*this, block);
+    c.next();
+    return compare_path(path, c.dir(), c.base());
+}
+
+std::size_t FileTable::find(const std::string &path) const
+{
+    // First block starting after path; the file can only be in the one
+    // before it.
+    std::size_t lo = 0, hi = blocks_.size();
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (compare(mid, path) < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    if (lo == 0)
+        return count_;
+    const std::size_t first = (lo - 1) * block_size;
+    const std::size_t last = std::min(first + block_size, count_);
+    Cursor c(*this, lo - 1);
+    for (std::size_t i = first; i < last; i++) {
+        c.next();
+        int r = compare_path(path, c.dir(), c.base());
+        if (r == 0)
+            return i;
+        if (r < 0)
+            break;
+    }
+    return count_;
+}
+
+std::size_t FileTable::memory_usage() const
+{
+    std::size_t n = sizeof *this + data_.capacity() +
+                    blocks_.capacity() * sizeof blocks_[0] +
+                    modes_.capacity() * sizeof modes_[0] +
+                    dirs_.capacity() * sizeof dirs_[0];
+    for (const std::string &d: dirs_)
+        n += d.capacity();
+    return n;
+}
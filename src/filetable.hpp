@@ -0,0 +1,80 @@
+#ifndef _PKGFS_FILETABLE_HPP
+#define _PKGFS_FILETABLE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+// Compact file list of a package, sorted by path.
+//
+// Directory names and file modes are dictionary coded.  Files are packed
+// into blocks of block_size entries; within a block basenames are front
+// coded against the previous entry and sizes and mtimes are delta coded,
+// all as varints.  The first entry of every block is stored in full, so
+// any entry is decoded by scanning at most one block, and a path is found
+// by binary search over the blocks.
+class FileTable {
+public:
+    struct File {
+        std::string path;
+        boost::uint64_t size;
+        boost::uint32_t mtime;
+        boost::uint16_t mode;
+    };
+
+    static const std::size_t block_size = 16;
+
+    FileTable(): count_(0) {}
+    // All columns are indexed by file; missing columns may be empty.
+    FileTable(const std::vector<std::string> &dirnames,
+              const std::vector<std::string> &basenames,
+              const std::vector<boost::uint32_t> &dirindexes,
+              const std::vector<boost::uint64_t> &sizes,
+              const std::vector<boost::uint16_t> &modes,
+              const std::vector<boost::uint32_t> &mtimes);
+
+    std::size_t size() const { return count_; }
+    File operator[](std::size_t i) const;
+    // Index of the file with the given path, or size() if there is none.
+    std::size_t find(const std::string &path) const;
+    // Memory held by the encoded table, in bytes.
+    std::size_t memory_usage() const;
+
+    template <typename F> void for_each(F f) const
+    {
+        if (count_ == 0)
+            return;
+        Cursor c(*this, 0);
+        for (std::size_t i = 0; i < count_; i++) {
+            c.next();
+            f(c.file());
+        }
+    }
+
+private:
+    std::size_t count_;
+    std::vector<std::string> dirs_;
+    std::vector<boost::uint16_t> modes_;
+    std::vector<boost::uint32_t> blocks_;
+    std::string data_;
+
+    // Sequential decoder positioned at the start of a block.
+    class Cursor {
+        const FileTable &table_;
+        const char *p_;
+        boost::uint32_t dir_;
+        std::string base_;
+        File file_;
+    public:
+        Cursor(const FileTable &table, std::size_t block);
+        void next();
+        const std::string &dir() const { return table_.dirs_[dir_]; }
+        const std::string &base() const { return base_; }
+        const File &file();
+    };
+
+    int compare(std::size_t block, const std::string &path) const;
+};
+
+#endif
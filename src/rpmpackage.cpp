@@ -0,0 +1,228 @@
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/endian/arithmetic.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/exception/info.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+
+#include "rpmpackage.hpp"
+
+namespace {
+
+    struct rpmlead {
+        unsigned char magic[4];
+        unsigned char major, minor;
+        boost::endian::big_uint16_t type;
+        boost::endian::big_uint16_t archnum;
+        char name[66];
+        boost::endian::big_uint16_t osnum;
+        boost::endian::big_uint16_t signature_type;
+        char reserved[16];
+    };
+
+    struct rpmheader {
+        unsigned char magic[3];
+        unsigned char version;
+        unsigned char reserved[4];
+        boost::endian::big_uint32_t num_index_entries;
+        boost::endian::big_uint32_t data_size;
+    };
+
+    struct rpmindex {
+        boost::endian::big_uint32_t tag;
+        boost::endian::big_uint32_t type;
+        boost::endian::big_uint32_t offset;
+        boost::endian::big_uint32_t count;
+    };
+
+    const unsigned char lead_magic[] = {0xED, 0xAB, 0xEE, 0xDB};
+    const unsigned char header_magic[] = {0x8e, 0xad, 0xe8};
+
+    // Headers larger than this are certainly corrupted.
+    const boost::uint32_t max_index_entries = 0x10000;
+    const boost::uint32_t max_data_size = 0x10000000;
+
+    rpmheader read_header(std::istream &in)
+    {
+        rpmheader header;
+        in.read(reinterpret_cast<char *>(&header), sizeof header);
+        if (!std::equal(header_magic, header_magic + sizeof header_magic,
+                        header.magic))
+            throw RpmPackage::bad_package("Bad header magic");
+        if (header.num_index_entries > max_index_entries ||
+            header.data_size > max_data_size)
+            throw RpmPackage::bad_package("Header is too large");
+        return header;
+    }
+
+    // Size of the value of an index entry, or 0 if it runs past the end.
+    std::size_t value_size(boost::uint32_t type, boost::uint32_t count,
+                           const char *p, const char *end)
+    {
+        std::size_t avail = end - p;
+        std::size_t elem;
+        switch (type) {
+        case RpmPackage::TYPE_NULL: return 0;
+        case RpmPackage::TYPE_CHAR:
+        case RpmPackage::TYPE_INT8:
+        case RpmPackage::TYPE_BIN: elem = 1; break;
+        case RpmPackage::TYPE_INT16: elem = 2; break;
+        case RpmPackage::TYPE_INT32: elem = 4; break;
+        case RpmPackage::TYPE_INT64: elem = 8; break;
+        case RpmPackage::TYPE_STRING:
+            count = 1;
+            // fall through
+        case RpmPackage::TYPE_STRING_ARRAY:
+        case RpmPackage::TYPE_I18NSTRING: {
+            const char *q = p;
+            for (boost::uint32_t i = 0; i < count; i++) {
+                q = std::find(q, end, '\0');
+                if (q == end)
+                    return 0;
+                ++q;
+            }
+            return q - p;
+        }
+        default: return 0;
+        }
+        if (count > avail / elem)
+            return 0;
+        return count * elem;
+    }
+}
+
+RpmPackage::RpmPackage(const std::string &filename)
+try {
+    std::ifstream in;
+    in.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try {
+        in.open(filename, std::ios::binary);
+        rpmlead lead;
+        in.read(reinterpret_cast<char *>(&lead), sizeof lead);
+        if (!std::equal(lead_magic, lead_magic + sizeof lead_magic,
+                        lead.magic))
+            throw bad_package("Bad lead magic");
+        rpmheader sig = read_header(in);
+        const std::istream::off_type sig_size =
+            sig.num_index_entries * sizeof(rpmindex) + sig.data_size;
+        // Main header is aligned to 8 bytes
+        in.seekg(sig_size + 7 - (sig_size + 7) % 8, std::istream::cur);
+        load_header(in);
+    } catch (const std::ios_base::failure &) {
+        throw bad_package(in.is_open() ? "Package is truncated or unreadable"
+                                       : "Cannot open package");
+    }
+    name_ = string(TAG_NAME);
+    if (name_.empty())
+        throw bad_package("Package has no name");
+    std::vector<boost::uint64_t> sizes = int64s(TAG_LONGFILESIZES);
+    if (sizes.empty()) {
+        std::vector<boost::uint32_t> short_sizes = int32s(TAG_FILESIZES);
+        sizes.assign(short_sizes.begin(), short_sizes.end());
+    }
+    try {
+        files_ = FileTable(strings(TAG_DIRNAMES), strings(TAG_BASENAMES),
+                           int32s(TAG_DIRINDEXES), sizes,
+                           int16s(TAG_FILEMODES), int32s(TAG_FILEMTIMES));
+    } catch (const std::invalid_argument &e) {
+        throw bad_package(e.what());
+    }
+} catch (boost::exception &e) {
+    e << boost::errinfo_file_name(filename);
+    throw;
+}
+
+void RpmPackage::load_header(std::istream &in)
+{
+    rpmheader header = read_header(in);
+    std::vector<rpmindex> raw(header.num_index_entries);
+    in.read(reinterpret_cast<char *>(raw.data()),
+            raw.size() * sizeof(rpmindex));
+    store_.resize(header.data_size);
+    in.read(store_.data(), store_.size());
+    const char *end = store_.data() + store_.size();
+    index_.reserve(raw.size());
+    for (const rpmindex &r: raw) {
+        if (r.offset >= store_.size())
+            continue;
+        Entry entry{r.tag, r.type, r.count, store_.data() + r.offset, 0};
+        entry.size = value_size(r.type, r.count, entry.data, end);
+        if (entry.size == 0 && r.type != TYPE_NULL)
+            continue;
+        index_.push_back(entry);
+    }
+    std::sort(index_.begin(), index_.end(),
+              [](const Entry &a, const Entry &b) { return a.tag < b.tag; });
+}
+
+std::string RpmPackage::nvra() const
+{
+    return name_ + '-' + string(TAG_VERSION) + '-' + string(TAG_RELEASE) +
+           '.' + string(TAG_ARCH);
+}
+
+const RpmPackage::Entry *RpmPackage::find(boost::uint32_t tag) const
+{
+    auto p = std::lower_bound(index_.begin(), index_.end(), tag,
+                              [](const Entry &e, boost::uint32_t t) {
+                                  return e.tag < t;
+                              });
+    return p != index_.end() && p->tag == tag ? &*p : nullptr;
+}
+
+std::string RpmPackage::string(boost::uint32_t tag) const
+{
+    const Entry *e = find(tag);
+    if (e == nullptr ||
+        (e->type != TYPE_STRING && e->type != TYPE_I18NSTRING))
+        return std::string();
+    return std::string(e->data);
+}
+
+std::vector<std::string> RpmPackage::strings(boost::uint32_t tag) const
+{
+    std::vector<std::string> result;
+    const Entry *e = find(tag);
+    if (e == nullptr || e->type != TYPE_STRING_ARRAY)
+        return result;
+    result.reserve(e->count);
+    for (const char *p = e->data; p < e->data + e->size;
+         p += std::strlen(p) + 1)
+        result.push_back(p);
+    return result;
+}
+
+template <typename T>
+std::vector<T> RpmPackage::ints(boost::uint32_t tag,
+                                boost::uint32_t type) const
+{
+    std::vector<T> result;
+    const Entry *e = find(tag);
+    if (e == nullptr || e->type != type)
+        return result;
+    result.reserve(e->count);
+    for (boost::uint32_t i = 0; i < e->count; i++) {
+        T n;
+        std::memcpy(&n, e->data + i * sizeof n, sizeof n);
+        result.push_back(boost::endian::big_to_native(n));
+    }
+    return result;
+}
+
+std::vector<boost::uint16_t> RpmPackage::int16s(boost::uint32_t tag) const
+{
+    return ints<boost::uint16_t>(tag, TYPE_INT16);
+}
+
+std::vector<boost::uint32_t> RpmPackage::int32s(boost::uint32_t tag) const
+{
+    return ints<boost::uint32_t>(tag, TYPE_INT32);
+}
+
+std::vector<boost::uint64_t> RpmPackage::int64s(boost::uint32_t tag) const
+{
+    return ints<boost::uint64_t>(tag, TYPE_INT64);
+}
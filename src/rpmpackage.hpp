@@ -0,0 +1,88 @@
+#ifndef _PKGFS_RPMPACKAGE_HPP
+#define _PKGFS_RPMPACKAGE_HPP
+
+#include <string>
+#include <vector>
+#include <exception>
+
+#include <boost/cstdint.hpp>
+#include <boost/exception/exception.hpp>
+
+#include "filetable.hpp"
+
+class RpmPackage {
+public:
+    enum Tag: boost::uint32_t {
+        TAG_NAME = 1000,
+        TAG_VERSION = 1001,
+        TAG_RELEASE = 1002,
+        TAG_ARCH = 1022,
+        TAG_FILESIZES = 1028,
+        TAG_FILEMODES = 1030,
+        TAG_FILEMTIMES = 1034,
+        TAG_DIRINDEXES = 1116,
+        TAG_BASENAMES = 1117,
+        TAG_DIRNAMES = 1118,
+        TAG_LONGFILESIZES = 5008
+    };
+
+    enum Type: boost::uint32_t {
+        TYPE_NULL = 0,
+        TYPE_CHAR = 1,
+        TYPE_INT8 = 2,
+        TYPE_INT16 = 3,
+        TYPE_INT32 = 4,
+        TYPE_INT64 = 5,
+        TYPE_STRING = 6,
+        TYPE_BIN = 7,
+        TYPE_STRING_ARRAY = 8,
+        TYPE_I18NSTRING = 9
+    };
+
+    struct exception: virtual std::exception, virtual boost::exception {};
+
+    class bad_package: public exception {
+        std::string msg_;
+    public:
+        bad_package(const std::string &msg): msg_(msg) {}
+        const char *what() const throw() override { return msg_.c_str(); }
+    };
+
+    // Header index entry with its value located in the data store.
+    // Numeric values are kept in network (big endian) byte order.
+    struct Entry {
+        boost::uint32_t tag;
+        boost::uint32_t type;
+        boost::uint32_t count;
+        const char *data;
+        std::size_t size;
+    };
+
+    explicit RpmPackage(const std::string &filename);
+    RpmPackage(const RpmPackage &) = delete;
+    RpmPackage &operator=(const RpmPackage &) = delete;
+
+    const std::string &name() const { return name_; }
+    // name-version-release.arch, as printed by rpm -q
+    std::string nvra() const;
+    const Entry *find(boost::uint32_t tag) const;
+    std::string string(boost::uint32_t tag) const;
+    std::vector<std::string> strings(boost::uint32_t tag) const;
+    std::vector<boost::uint16_t> int16s(boost::uint32_t tag) const;
+    std::vector<boost::uint32_t> int32s(boost::uint32_t tag) const;
+    std::vector<boost::uint64_t> int64s(boost::uint32_t tag) const;
+    const FileTable &files() const { return files_; }
+
+private:
+    std::vector<char> store_;
+    std::vector<Entry> index_;
+    std::string name_;
+    FileTable files_;
+
+    template <typename T>
+    std::vector<T> ints(boost::uint32_t tag, boost::uint32_t type) const;
+
+    void load_header(std::istream &in);
+};
+
+#endif
@@ -0,0 +1,322 @@
+#include <list>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.hpp"
+
+namespace {
+
+    volatile std::sig_atomic_t stop_requested = 0;
+
+    extern "C" void request_stop(int)
+    {
+        stop_requested = 1;
+    }
+
+    // Stop reading from a client that does not collect its replies.
+    const std::size_t max_pending_output = 0x400000;
+
+    std::system_error system_error(const std::string &what)
+    {
+        return std::system_error(errno, std::system_category(), what);
+    }
+
+    // A socket file nobody listens on any more.
+    bool is_stale_socket(const sockaddr_un &addr)
+    {
+        struct stat st;
+        if (::lstat(addr.sun_path, &st) < 0 || !S_ISSOCK(st.st_mode))
+            return false;
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+        bool stale = ::connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                               sizeof addr) < 0 && errno == ECONNREFUSED;
+        ::close(fd);
+        return stale;
+    }
+
+    boost::uint32_t get_u32(const char *p)
+    {
+        const unsigned char *q = reinterpret_cast<const unsigned char *>(p);
+        return boost::uint32_t(q[0]) << 24 | boost::uint32_t(q[1]) << 16 |
+               boost::uint32_t(q[2]) << 8 | boost::uint32_t(q[3]);
+    }
+
+    boost::uint16_t get_u16(const char *p)
+    {
+        const unsigned char *q = reinterpret_cast<const unsigned char *>(p);
+        return boost::uint16_t(q[0] << 8 | q[1]);
+    }
+
+    void put_u32(std::string &out, boost::uint32_t n)
+    {
+        const char b[] = {char(n >> 24), char(n >> 16), char(n >> 8), char(n)};
+        out.append(b, sizeof b);
+    }
+
+    void put_u32_at(std::string &out, std::size_t pos, boost::uint32_t n)
+    {
+        out[pos] = char(n >> 24);
+        out[pos + 1] = char(n >> 16);
+        out[pos + 2] = char(n >> 8);
+        out[pos + 3] = char(n);
+    }
+}
+
+struct Server::Connection {
+    int fd;
+    std::vector<char> in;
+    std::string out;
+    std::size_t out_pos;
+    bool eof;
+
+    explicit Connection(int f): fd(f), out_pos(0), eof(false) {}
+    std::size_t pending() const { return out.size() - out_pos; }
+    Connection(const Connection &) = delete;
+    ~Connection() { ::close(fd); }
+};
+
+Server::Server(const catalog &packages, const std::string &socket_path)
+: packages_(packages), socket_path_(socket_path), listen_fd_(-1),
+  socket_dev_(0), socket_ino_(0)
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof addr.sun_path)
+        throw std::invalid_argument("Socket path is too long: " + socket_path);
+    std::copy(socket_path.begin(), socket_path.end(), addr.sun_path);
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+    if (listen_fd_ < 0)
+        throw system_error("socket");
+    int rc = ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr),
+                    sizeof addr);
+    // Replace a stale socket left by a previous instance, nothing else.
+    if (rc < 0 && errno == EADDRINUSE && is_stale_socket(addr)) {
+        ::unlink(socket_path.c_str());
+        rc = ::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr),
+                    sizeof addr);
+    }
+    if (rc < 0) {
+        std::system_error e = system_error("bind " + socket_path);
+        ::close(listen_fd_);
+        throw e;
+    }
+    struct stat st;
+    if (::lstat(socket_path.c_str(), &st) < 0 ||
+        ::listen(listen_fd_, SOMAXCONN) < 0) {
+        std::system_error e = system_error("listen");
+        ::close(listen_fd_);
+        ::unlink(socket_path.c_str());
+        throw e;
+    }
+    socket_dev_ = st.st_dev;
+    socket_ino_ = st.st_ino;
+}
+
+Server::~Server()
+{
+    ::close(listen_fd_);
+    // Someone may have replaced the socket file since; leave theirs alone.
+    struct stat st;
+    if (::lstat(socket_path_.c_str(), &st) == 0 &&
+        st.st_dev == socket_dev_ && st.st_ino == socket_ino_)
+        ::unlink(socket_path_.c_str());
+}
+
+void Server::run()
+{
+    // Stop signals are only delivered inside ppoll(), so one arriving
+    // just before it cannot be missed.
+    sigset_t stop_signals, saved_mask, wait_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    ::sigprocmask(SIG_BLOCK, &stop_signals, &saved_mask);
+    wait_mask = saved_mask;
+    sigdelset(&wait_mask, SIGINT);
+    sigdelset(&wait_mask, SIGTERM);
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof sa);
+    sa.sa_handler = request_stop;
+    ::sigaction(SIGINT, &sa, nullptr);
+    ::sigaction(SIGTERM, &sa, nullptr);
+
+    std::list<Connection> conns;
+    std::vector<pollfd> fds;
+    while (!stop_requested) {
+        fds.clear();
+        fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+        for (const Connection &c: conns) {
+            short events = 0;
+            if (!c.eof && c.pending() < max_pending_output)
+                events |= POLLIN;
+            if (c.pending() > 0)
+                events |= POLLOUT;
+            fds.push_back(pollfd{c.fd, events, 0});
+        }
+        if (::ppoll(fds.data(), fds.size(), nullptr, &wait_mask) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw system_error("poll");
+        }
+        auto fd = fds.begin() + 1;
+        for (auto c = conns.begin(); c != conns.end(); ++fd) {
+            bool alive = true;
+            if (fd->revents & (POLLIN | POLLHUP | POLLERR))
+                alive = receive(*c);
+            if (alive && c->pending() > 0)
+                alive = transmit(*c) && process(*c);
+            // A client that has finished sending still gets its replies.
+            if (alive && c->eof && c->pending() == 0)
+                alive = false;
+            if (alive)
+                ++c;
+            else
+                c = conns.erase(c);
+        }
+        if (fds.front().revents & POLLIN) {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0)
+                conns.emplace_back(fd);
+        }
+    }
+    ::sigprocmask(SIG_SETMASK, &saved_mask, nullptr);
+}
+
+bool Server::receive(Connection &conn)
+{
+    char buf[0x10000];
+    ssize_t n = ::read(conn.fd, buf, sizeof buf);
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+    if (n == 0) {
+        conn.eof = true;
+        return true;
+    }
+    conn.in.insert(conn.in.end(), buf, buf + n);
+    return process(conn);
+}
+
+bool Server::process(Connection &conn)
+{
+    return process(conn.in, conn.out, conn.out_pos + max_pending_output);
+}
+
+bool Server::process(std::vector<char> &in, std::string &out,
+                     std::size_t limit) const
+{
+    std::size_t pos = 0;
+    while (out.size() < limit && in.size() - pos >= 4) {
+        boost::uint32_t len = get_u32(in.data() + pos);
+        // Too short to carry an id and an op, or too long to be sane.
+        if (len < 5 || len > max_request_size)
+            return false;
+        if (in.size() - pos - 4 < len)
+            break;
+        handle(in.data() + pos + 4, len, out);
+        pos += 4 + len;
+    }
+    in.erase(in.begin(), in.begin() + pos);
+    return true;
+}
+
+bool Server::transmit(Connection &conn)
+{
+    ssize_t n = ::send(conn.fd, conn.out.data() + conn.out_pos,
+                       conn.pending(), MSG_NOSIGNAL);
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+    conn.out_pos += n;
+    if (conn.pending() == 0) {
+        conn.out.clear();
+        conn.out_pos = 0;
+    } else if (conn.out_pos >= max_pending_output) {
+        conn.out.erase(0, conn.out_pos);
+        conn.out_pos = 0;
+    }
+    return true;
+}
+
+void Server::handle(const char *req, std::size_t size, std::string &out) const
+{
+    const std::size_t start = out.size();
+    put_u32(out, 0);
+    put_u32(out, size >= 4 ? get_u32(req) : 0);
+    out.push_back(STATUS_BAD_REQUEST);
+    const std::size_t status_pos = out.size() - 1;
+    if (size < 5) {
+        put_u32_at(out, start, out.size() - start - 4);
+        return;
+    }
+
+    const RpmPackage *pkg = nullptr;
+    const char *p = req + 5;
+    const char *end = req + size;
+    if (size >= 7 && get_u16(p) <= std::size_t(end - p - 2)) {
+        std::string name(p + 2, get_u16(p));
+        p += 2 + name.size();
+        catalog::const_iterator c = packages_.find(name);
+        if (c != packages_.end())
+            pkg = c->second.get();
+        else
+            out[status_pos] = STATUS_NOT_FOUND;
+    }
+
+    if (pkg != nullptr) {
+        switch (req[4]) {
+        case OP_TAG:
+            if (end - p == 4) {
+                const RpmPackage::Entry *e = pkg->find(get_u32(p));
+                if (e != nullptr) {
+                    put_u32(out, e->type);
+                    put_u32(out, e->count);
+                    out.append(e->data, e->size);
+                    out[status_pos] = STATUS_OK;
+                } else {
+                    out[status_pos] = STATUS_NOT_FOUND;
+                }
+            }
+            break;
+        case OP_FILES:
+            if (p == end) {
+                put_u32(out, pkg->files().size());
+                pkg->files().for_each([&](const FileTable::File &f) {
+                    out.append(f.path.c_str(), f.path.size() + 1);
+                });
+                out[status_pos] = STATUS_OK;
+            }
+            break;
+        case OP_STAT: {
+            const FileTable &files = pkg->files();
+            std::size_t i = files.find(std::string(p, end));
+            if (i != files.size()) {
+                FileTable::File f = files[i];
+                put_u32(out, f.size >> 32);
+                put_u32(out, f.size);
+                put_u32(out, f.mtime);
+                out.push_back(char(f.mode >> 8));
+                out.push_back(char(f.mode));
+                out[status_pos] = STATUS_OK;
+            } else {
+                out[status_pos] = STATUS_NOT_FOUND;
+            }
+            break;
+        }
+        }
+    }
+    put_u32_at(out, start, out.size() - start - 4);
+}
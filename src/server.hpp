@@ -0,0 +1,79 @@
+#ifndef _PKGFS_SERVER_HPP
+#define _PKGFS_SERVER_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/cstdint.hpp>
+
+#include "rpmpackage.hpp"
+
+// Serves package metadata over a Unix domain socket.
+//
+// All integers are big endian.  Each request is a frame
+//     u32 length, u32 id, u8 op, payload
+// and is answered by a frame
+//     u32 length, u32 id, u8 status, payload
+// where length counts the bytes following it.  Clients may pipeline any
+// number of requests; replies on a connection come back in request order.
+// A request frame shorter than 5 bytes or longer than max_request_size
+// closes the connection.
+//
+// Requests (name is u16 length followed by the package name in
+// name-version-release.arch form, e.g. glibc-2.38-16.fc39.i686, so that
+// multilib and multi-version sets can be served side by side):
+//     OP_TAG    name, u32 tag  ->  u32 type, u32 count, raw header value
+//     OP_FILES  name           ->  u32 count, NUL terminated paths
+//     OP_STAT   name, path     ->  u64 size, u32 mtime, u16 mode
+class Server {
+public:
+    enum Op: boost::uint8_t {
+        OP_TAG = 1,
+        OP_FILES = 2,
+        OP_STAT = 3
+    };
+
+    enum Status: boost::uint8_t {
+        STATUS_OK = 0,
+        STATUS_NOT_FOUND = 1,
+        STATUS_BAD_REQUEST = 2
+    };
+
+    using catalog = std::map<std::string, std::unique_ptr<RpmPackage>>;
+
+    static const boost::uint32_t max_request_size = 0x10000;
+
+    Server(const catalog &packages, const std::string &socket_path);
+    ~Server();
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    void run();
+
+    // Answers the complete requests at the start of in and removes them,
+    // stopping once out holds limit bytes so that the rest wait until the
+    // client collects some replies.  Returns false on a malformed frame.
+    bool process(std::vector<char> &in, std::string &out,
+                 std::size_t limit) const;
+    // Appends the reply to a single request frame without its length.
+    void handle(const char *req, std::size_t size, std::string &out) const;
+
+private:
+    struct Connection;
+
+    const catalog &packages_;
+    std::string socket_path_;
+    int listen_fd_;
+    dev_t socket_dev_;
+    ino_t socket_ino_;
+
+    bool receive(Connection &conn);
+    bool transmit(Connection &conn);
+    bool process(Connection &conn);
+};
+
+#endif
@@ -0,0 +1,193 @@
+#define BOOST_TEST_MODULE filetable
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "filetable.hpp"
+
+BOOST_AUTO_TEST_CASE(empty_table)
+{
+    const std::vector<FileTable> tables{
+        FileTable(),
+        FileTable({}, {}, {}, {}, {}, {})
+    };
+    for (const FileTable &t: tables) {
+        BOOST_CHECK_EQUAL(t.size(), 0u);
+        BOOST_CHECK_EQUAL(t.find("/usr/bin/foo"), t.size());
+        BOOST_CHECK_EQUAL(t.find(""), t.size());
+        std::size_t visited = 0;
+        t.for_each([&](const FileTable::File &) { visited++; });
+        BOOST_CHECK_EQUAL(visited, 0u);
+    }
+}
+
+namespace {
+
+    struct Columns {
+        std::vector<std::string> dirnames;
+        std::vector<std::string> basenames;
+        std::vector<boost::uint32_t> dirindexes;
+        std::vector<boost::uint64_t> sizes;
+        std::vector<boost::uint16_t> modes;
+        std::vector<boost::uint32_t> mtimes;
+
+        FileTable table() const
+        {
+            return FileTable(dirnames, basenames, dirindexes,
+                             sizes, modes, mtimes);
+        }
+
+        // Files as the table should return them, sorted by path.
+        std::vector<FileTable::File> expected() const
+        {
+            std::vector<FileTable::File> files;
+            for (std::size_t i = 0; i < basenames.size(); i++)
+                files.push_back(FileTable::File{
+                    dirnames[dirindexes[i]] + basenames[i],
+                    sizes.empty() ? 0 : sizes[i],
+                    mtimes.empty() ? 0 : mtimes[i],
+                    modes.empty() ? boost::uint16_t(0) : modes[i]
+                });
+            std::sort(files.begin(), files.end(),
+                      [](const FileTable::File &a, const FileTable::File &b) {
+                          return a.path < b.path;
+                      });
+            return files;
+        }
+    };
+
+    // Files spread over a few directories with shared basename prefixes,
+    // non-ASCII bytes, 64-bit sizes, mtimes going both ways and mixed modes.
+    Columns make_columns(std::size_t count, unsigned int seed)
+    {
+        std::mt19937 rng(seed);
+        Columns c;
+        c.dirnames = {"/etc/", "/usr/bin/", "/usr/share/doc/caf\xc3\xa9/",
+                      "/usr/share/\xff/"};
+        const boost::uint16_t modes[] = {0100644, 0100755, 040755, 0120777};
+        for (std::size_t i = 0; i < count; i++) {
+            std::string base = "file";
+            for (unsigned int n = rng() % 6; n > 0; n--)
+                base.push_back(char(rng() % 2 ? 'a' + rng() % 3 : rng()));
+            base += std::to_string(i);
+            c.basenames.push_back(base);
+            c.dirindexes.push_back(rng() % c.dirnames.size());
+            c.sizes.push_back(rng() % 4 == 0
+                              ? (boost::uint64_t(rng()) << 32 | rng())
+                              : rng() % 100000);
+            c.modes.push_back(modes[rng() % 4]);
+            c.mtimes.push_back(rng());
+        }
+        return c;
+    }
+
+    void check_round_trip(const Columns &c)
+    {
+        const FileTable t = c.table();
+        const std::vector<FileTable::File> expected = c.expected();
+        BOOST_REQUIRE_EQUAL(t.size(), expected.size());
+        std::set<std::string> paths;
+        for (const FileTable::File &f: expected)
+            paths.insert(f.path);
+
+        std::size_t i = 0;
+        t.for_each([&](const FileTable::File &f) {
+            BOOST_REQUIRE_LT(i, expected.size());
+            BOOST_CHECK_EQUAL(f.path, expected[i].path);
+            i++;
+        });
+        BOOST_CHECK_EQUAL(i, expected.size());
+
+        for (i = 0; i < expected.size(); i++) {
+            const FileTable::File f = t[i];
+            BOOST_CHECK_EQUAL(f.path, expected[i].path);
+            BOOST_CHECK_EQUAL(f.size, expected[i].size);
+            BOOST_CHECK_EQUAL(f.mtime, expected[i].mtime);
+            BOOST_CHECK_EQUAL(f.mode, expected[i].mode);
+            BOOST_CHECK_EQUAL(t.find(expected[i].path), i);
+            // Neighbours of an existing path are found only if they exist.
+            for (const std::string &p: {
+                     expected[i].path + '\0',
+                     expected[i].path.substr(0, expected[i].path.size() - 1)
+                 }) {
+                std::size_t j = t.find(p);
+                if (paths.count(p))
+                    BOOST_CHECK_EQUAL(t[j].path, p);
+                else
+                    BOOST_CHECK_EQUAL(j, t.size());
+            }
+        }
+
+        BOOST_CHECK_EQUAL(t.find(""), t.size());
+        BOOST_CHECK_EQUAL(t.find("/"), t.size());
+        BOOST_CHECK_EQUAL(t.find("\xff\xff"), t.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(single_file)
+{
+    check_round_trip(make_columns(1, 1));
+}
+
+BOOST_AUTO_TEST_CASE(one_block)
+{
+    check_round_trip(make_columns(FileTable::block_size - 1, 2));
+}
+
+BOOST_AUTO_TEST_CASE(exactly_one_full_block)
+{
+    check_round_trip(make_columns(FileTable::block_size, 3));
+}
+
+BOOST_AUTO_TEST_CASE(block_boundary)
+{
+    check_round_trip(make_columns(FileTable::block_size + 1, 4));
+    check_round_trip(make_columns(FileTable::block_size * 2, 5));
+}
+
+BOOST_AUTO_TEST_CASE(many_blocks)
+{
+    check_round_trip(make_columns(5000, 6));
+}
+
+BOOST_AUTO_TEST_CASE(before_first_and_after_last)
+{
+    Columns c;
+    c.dirnames = {"/usr/bin/"};
+    for (std::size_t i = 0; i < FileTable::block_size * 3; i++) {
+        c.basenames.push_back("f" + std::to_string(100 + i));
+        c.dirindexes.push_back(0);
+    }
+    const FileTable t = c.table();
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/f100"), 0u);
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/f099"), t.size());
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/"), t.size());
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/f147"), t.size() - 1);
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/f148"), t.size());
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/g"), t.size());
+    BOOST_CHECK_EQUAL(t.find("/usr/bin/f1470"), t.size());
+}
+
+BOOST_AUTO_TEST_CASE(missing_columns)
+{
+    Columns c = make_columns(40, 7);
+    c.sizes.clear();
+    c.modes.clear();
+    c.mtimes.clear();
+    check_round_trip(c);
+}
+
+BOOST_AUTO_TEST_CASE(inconsistent_columns)
+{
+    Columns c = make_columns(10, 8);
+    c.dirindexes.back() = c.dirnames.size();
+    BOOST_CHECK_THROW(c.table(), std::invalid_argument);
+    c = make_columns(10, 8);
+    c.mtimes.pop_back();
+    BOOST_CHECK_THROW(c.table(), std::invalid_argument);
+}
@@ -0,0 +1,148 @@
+#ifndef _PKGFS_TESTS_RPMBUILDER_HPP
+#define _PKGFS_TESTS_RPMBUILDER_HPP
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <boost/cstdint.hpp>
+
+#include "rpmpackage.hpp"
+
+// Builds a minimal RPM file in memory: a lead, an empty signature and a
+// main header with the given entries.
+class RpmBuilder {
+    struct Index {
+        boost::uint32_t tag, type, offset, count;
+    };
+    std::vector<Index> index_;
+    std::string store_;
+
+    static void put_u32(std::string &out, boost::uint32_t n)
+    {
+        const char b[] = {char(n >> 24), char(n >> 16), char(n >> 8), char(n)};
+        out.append(b, sizeof b);
+    }
+
+    static std::string header(const std::vector<Index> &index,
+                              const std::string &store)
+    {
+        std::string h("\x8e\xad\xe8\x01\0\0\0\0", 8);
+        put_u32(h, index.size());
+        put_u32(h, store.size());
+        for (const Index &i: index) {
+            put_u32(h, i.tag);
+            put_u32(h, i.type);
+            put_u32(h, i.offset);
+            put_u32(h, i.count);
+        }
+        return h + store;
+    }
+
+    RpmBuilder &add(boost::uint32_t tag, boost::uint32_t type,
+                    boost::uint32_t count, const std::string &data,
+                    std::size_t align = 1)
+    {
+        while (store_.size() % align)
+            store_.push_back('\0');
+        index_.push_back(Index{tag, type, boost::uint32_t(store_.size()),
+                               count});
+        store_ += data;
+        return *this;
+    }
+
+public:
+    RpmBuilder &string(boost::uint32_t tag, const std::string &s)
+    {
+        return add(tag, RpmPackage::TYPE_STRING, 1, s + '\0');
+    }
+
+    RpmBuilder &strings(boost::uint32_t tag,
+                        const std::vector<std::string> &v)
+    {
+        std::string data;
+        for (const std::string &s: v)
+            data += s + '\0';
+        return add(tag, RpmPackage::TYPE_STRING_ARRAY, v.size(), data);
+    }
+
+    RpmBuilder &int32s(boost::uint32_t tag,
+                       const std::vector<boost::uint32_t> &v)
+    {
+        std::string data;
+        for (boost::uint32_t n: v)
+            put_u32(data, n);
+        return add(tag, RpmPackage::TYPE_INT32, v.size(), data, 4);
+    }
+
+    RpmBuilder &int16s(boost::uint32_t tag,
+                       const std::vector<boost::uint16_t> &v)
+    {
+        std::string data;
+        for (boost::uint16_t n: v) {
+            data.push_back(char(n >> 8));
+            data.push_back(char(n));
+        }
+        return add(tag, RpmPackage::TYPE_INT16, v.size(), data, 2);
+    }
+
+    RpmBuilder &bin(boost::uint32_t tag, const std::string &data)
+    {
+        return add(tag, RpmPackage::TYPE_BIN, data.size(), data);
+    }
+
+    std::size_t store_size() const { return store_.size(); }
+
+    // Index entry whose value is whatever lies at offset, if anything.
+    RpmBuilder &raw(boost::uint32_t tag, boost::uint32_t type,
+                    boost::uint32_t count, boost::uint32_t offset)
+    {
+        index_.push_back(Index{tag, type, offset, count});
+        return *this;
+    }
+
+    RpmBuilder &package(const std::string &name, const std::string &arch,
+                        const std::vector<std::string> &dirs,
+                        const std::vector<std::string> &bases,
+                        const std::vector<boost::uint32_t> &dirindexes)
+    {
+        string(RpmPackage::TAG_NAME, name);
+        string(RpmPackage::TAG_VERSION, "1.0");
+        string(RpmPackage::TAG_RELEASE, "1");
+        string(RpmPackage::TAG_ARCH, arch);
+        strings(RpmPackage::TAG_DIRNAMES, dirs);
+        strings(RpmPackage::TAG_BASENAMES, bases);
+        return int32s(RpmPackage::TAG_DIRINDEXES, dirindexes);
+    }
+
+    std::string build() const
+    {
+        std::string lead("\xed\xab\xee\xdb\x03\x00", 6);
+        lead.resize(96, '\0');
+        // The empty signature is 16 bytes, so the header stays aligned.
+        return lead + header({}, "") + header(index_, store_);
+    }
+};
+
+// File with the given contents, removed when it goes out of scope.
+class TempFile {
+    std::string path_;
+public:
+    explicit TempFile(const std::string &contents)
+    {
+        char name[] = "/tmp/pkgfs-test-XXXXXX";
+        int fd = ::mkstemp(name);
+        if (fd >= 0)
+            ::close(fd);
+        path_ = name;
+        std::ofstream(path_, std::ios::binary) << contents;
+    }
+    TempFile(const TempFile &) = delete;
+    ~TempFile() { ::unlink(path_.c_str()); }
+    const std::string &path() const { return path_; }
+};
+
+#endif
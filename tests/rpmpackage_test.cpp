@@ -0,0 +1,135 @@
+#define BOOST_TEST_MODULE rpmpackage
+#include <boost/test/included/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/exception/get_error_info.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+
+#include "rpmpackage.hpp"
+#include "rpmbuilder.hpp"
+
+namespace {
+
+    RpmBuilder sample()
+    {
+        RpmBuilder b;
+        b.package("foo", "x86_64", {"/etc/", "/usr/bin/"},
+                  {"foo", "foo.conf"}, {1, 0});
+        b.int16s(RpmPackage::TAG_FILEMODES, {0100755, 0100644});
+        return b;
+    }
+
+    // Checks that loading contents fails with bad_package naming the file.
+    void check_rejected(const std::string &contents)
+    {
+        TempFile f(contents);
+        try {
+            RpmPackage pkg(f.path());
+            BOOST_ERROR("package of " << contents.size()
+                        << " bytes was accepted");
+        } catch (const RpmPackage::bad_package &e) {
+            const std::string *name =
+                boost::get_error_info<boost::errinfo_file_name>(e);
+            BOOST_REQUIRE(name != nullptr);
+            BOOST_CHECK_EQUAL(*name, f.path());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parse_package)
+{
+    TempFile f(sample().build());
+    RpmPackage pkg(f.path());
+    BOOST_CHECK_EQUAL(pkg.name(), "foo");
+    BOOST_CHECK_EQUAL(pkg.nvra(), "foo-1.0-1.x86_64");
+    BOOST_CHECK_EQUAL(pkg.string(RpmPackage::TAG_ARCH), "x86_64");
+    BOOST_CHECK(pkg.find(RpmPackage::TAG_FILESIZES) == nullptr);
+    const std::vector<boost::uint32_t> dirindexes{1, 0};
+    BOOST_CHECK(pkg.int32s(RpmPackage::TAG_DIRINDEXES) == dirindexes);
+    BOOST_REQUIRE_EQUAL(pkg.files().size(), 2u);
+    BOOST_CHECK_EQUAL(pkg.files()[0].path, "/etc/foo.conf");
+    BOOST_CHECK_EQUAL(pkg.files()[0].mode, 0100644);
+    BOOST_CHECK_EQUAL(pkg.files()[1].path, "/usr/bin/foo");
+    BOOST_CHECK_EQUAL(pkg.files()[1].mode, 0100755);
+}
+
+BOOST_AUTO_TEST_CASE(missing_file)
+{
+    std::string path;
+    {
+        TempFile f("");
+        path = f.path();
+    }
+    BOOST_CHECK_THROW(RpmPackage pkg(path), RpmPackage::bad_package);
+}
+
+BOOST_AUTO_TEST_CASE(truncated_package)
+{
+    const std::string contents = sample().build();
+    for (std::size_t size = 0; size < contents.size(); size++)
+        check_rejected(contents.substr(0, size));
+}
+
+BOOST_AUTO_TEST_CASE(bad_magic)
+{
+    std::string contents = sample().build();
+    contents[0] = 'x';
+    check_rejected(contents);
+    contents = sample().build();
+    contents[96] = 'x';
+    check_rejected(contents);
+    contents = sample().build();
+    contents[112] = 'x';
+    check_rejected(contents);
+}
+
+BOOST_AUTO_TEST_CASE(missing_name)
+{
+    RpmBuilder b;
+    b.string(RpmPackage::TAG_VERSION, "1.0");
+    check_rejected(b.build());
+}
+
+BOOST_AUTO_TEST_CASE(inconsistent_file_list)
+{
+    RpmBuilder b;
+    b.package("foo", "x86_64", {"/etc/"}, {"a", "b"}, {0, 1});
+    check_rejected(b.build());
+    RpmBuilder c;
+    c.package("foo", "x86_64", {"/etc/"}, {"a", "b"}, {0});
+    check_rejected(c.build());
+}
+
+BOOST_AUTO_TEST_CASE(out_of_range_entries)
+{
+    RpmBuilder b = sample();
+    b.raw(2000, RpmPackage::TYPE_INT32, 1, 0x100000);
+    b.raw(2001, RpmPackage::TYPE_INT32, 0x40000000, 0);
+    b.raw(2002, RpmPackage::TYPE_INT64, 0xffffffff, 0);
+    b.raw(2003, RpmPackage::TYPE_STRING_ARRAY, 1000, 0);
+    b.raw(2004, 42, 1, 0);
+    TempFile f(b.build());
+    RpmPackage pkg(f.path());
+    BOOST_CHECK_EQUAL(pkg.name(), "foo");
+    for (boost::uint32_t tag = 2000; tag <= 2004; tag++)
+        BOOST_CHECK_MESSAGE(pkg.find(tag) == nullptr,
+                            "tag " << tag << " was accepted");
+    BOOST_CHECK(pkg.int32s(2001).empty());
+    BOOST_CHECK(pkg.strings(2003).empty());
+}
+
+BOOST_AUTO_TEST_CASE(unterminated_string)
+{
+    RpmBuilder b = sample();
+    const std::size_t offset = b.store_size();
+    b.bin(2001, "abc");
+    b.raw(2000, RpmPackage::TYPE_STRING, 1, offset);
+    TempFile f(b.build());
+    RpmPackage pkg(f.path());
+    BOOST_REQUIRE(pkg.find(2001) != nullptr);
+    BOOST_CHECK_EQUAL(pkg.find(2001)->size, 3u);
+    BOOST_CHECK(pkg.find(2000) == nullptr);
+    BOOST_CHECK_EQUAL(pkg.string(2000), "");
+}
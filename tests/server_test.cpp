@@ -0,0 +1,413 @@
+#define BOOST_TEST_MODULE server
+#include <boost/test/included/unit_test.hpp>
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "server.hpp"
+#include "rpmbuilder.hpp"
+
+namespace {
+
+    const std::string foo64 = "foo-1.0-1.x86_64";
+    const std::string foo32 = "foo-1.0-1.i686";
+    const std::string big = "big-1.0-1.noarch";
+    const std::size_t big_files = 20000;
+    const std::size_t no_limit = std::numeric_limits<std::size_t>::max();
+
+    struct Reply {
+        boost::uint32_t id;
+        unsigned int status;
+        std::string payload;
+    };
+
+    void put_u32(std::string &out, boost::uint32_t n)
+    {
+        const char b[] = {char(n >> 24), char(n >> 16), char(n >> 8), char(n)};
+        out.append(b, sizeof b);
+    }
+
+    boost::uint32_t get_u32(const std::string &s, std::size_t pos)
+    {
+        return boost::uint32_t((unsigned char)s[pos]) << 24 |
+               boost::uint32_t((unsigned char)s[pos + 1]) << 16 |
+               boost::uint32_t((unsigned char)s[pos + 2]) << 8 |
+               boost::uint32_t((unsigned char)s[pos + 3]);
+    }
+
+    std::string frame(boost::uint32_t id, unsigned int op,
+                      const std::string &name, const std::string &arg = "")
+    {
+        std::string body;
+        put_u32(body, id);
+        body.push_back(char(op));
+        body.push_back(char(name.size() >> 8));
+        body.push_back(char(name.size()));
+        body += name + arg;
+        std::string f;
+        put_u32(f, body.size());
+        return f + body;
+    }
+
+    std::string tag_arg(boost::uint32_t tag)
+    {
+        std::string s;
+        put_u32(s, tag);
+        return s;
+    }
+
+    std::vector<Reply> parse(const std::string &out)
+    {
+        std::vector<Reply> replies;
+        std::size_t pos = 0;
+        while (pos < out.size()) {
+            BOOST_REQUIRE_LE(pos + 9, out.size());
+            const boost::uint32_t len = get_u32(out, pos);
+            BOOST_REQUIRE_GE(len, 5u);
+            BOOST_REQUIRE_LE(pos + 4 + len, out.size());
+            replies.push_back(Reply{get_u32(out, pos + 4),
+                                    (unsigned char)out[pos + 8],
+                                    out.substr(pos + 9, len - 5)});
+            pos += 4 + len;
+        }
+        return replies;
+    }
+
+    std::vector<char> bytes(const std::string &s)
+    {
+        return std::vector<char>(s.begin(), s.end());
+    }
+
+    // Packages loaded from temporary files and a socket path to serve
+    // them on.
+    struct Fixture {
+        std::vector<std::unique_ptr<TempFile>> files;
+        Server::catalog packages;
+        std::string dir;
+        std::string socket_path;
+
+        void add(const RpmBuilder &b)
+        {
+            files.emplace_back(new TempFile(b.build()));
+            std::unique_ptr<RpmPackage> pkg{
+                new RpmPackage(files.back()->path())};
+            const std::string nvra = pkg->nvra();
+            packages.emplace(nvra, std::move(pkg));
+        }
+
+        Fixture()
+        {
+            RpmBuilder a, b, c;
+            a.package("foo", "x86_64", {"/etc/", "/usr/bin/"},
+                      {"foo", "foo.conf"}, {1, 0});
+            a.int16s(RpmPackage::TAG_FILEMODES, {0100755, 0100644});
+            add(a);
+            b.package("foo", "i686", {"/usr/lib/"}, {"libfoo.so"}, {0});
+            add(b);
+            std::vector<std::string> bases;
+            for (std::size_t i = 0; i < big_files; i++)
+                bases.push_back("file" + std::to_string(i));
+            c.package("big", "noarch", {"/usr/share/big/"}, bases,
+                      std::vector<boost::uint32_t>(big_files, 0));
+            add(c);
+            char name[] = "/tmp/pkgfs-test-XXXXXX";
+            BOOST_REQUIRE(::mkdtemp(name) != nullptr);
+            dir = name;
+            socket_path = dir + "/s.sock";
+        }
+
+        ~Fixture()
+        {
+            ::unlink(socket_path.c_str());
+            ::rmdir(dir.c_str());
+        }
+    };
+
+    sockaddr_un socket_address(const std::string &path)
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof addr);
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof addr.sun_path - 1);
+        return addr;
+    }
+
+    bool exists(const std::string &path)
+    {
+        struct stat st;
+        return ::lstat(path.c_str(), &st) == 0;
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(server, Fixture)
+
+BOOST_AUTO_TEST_CASE(pipelined_requests)
+{
+    Server s(packages, socket_path);
+    std::vector<char> in = bytes(
+        frame(1, Server::OP_FILES, foo64) +
+        frame(2, Server::OP_TAG, foo32, tag_arg(RpmPackage::TAG_ARCH)) +
+        frame(3, Server::OP_STAT, foo64, "/usr/bin/foo") +
+        frame(4, Server::OP_FILES, foo32));
+    std::string out;
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    BOOST_CHECK(in.empty());
+    const std::vector<Reply> r = parse(out);
+    BOOST_REQUIRE_EQUAL(r.size(), 4u);
+    for (std::size_t i = 0; i < r.size(); i++) {
+        BOOST_CHECK_EQUAL(r[i].id, i + 1);
+        BOOST_CHECK_EQUAL(r[i].status, Server::STATUS_OK);
+    }
+    BOOST_CHECK_EQUAL(r[0].payload,
+                      std::string("\0\0\0\2/etc/foo.conf\0/usr/bin/foo\0",
+                                  31));
+    BOOST_CHECK_EQUAL(r[1].payload,
+                      std::string("\0\0\0\6\0\0\0\1i686\0", 13));
+    BOOST_CHECK_EQUAL(r[2].payload,
+                      std::string(12, '\0') + "\x81\xed");
+    BOOST_CHECK_EQUAL(r[3].payload,
+                      std::string("\0\0\0\1/usr/lib/libfoo.so\0", 23));
+}
+
+BOOST_AUTO_TEST_CASE(partial_trailing_frame)
+{
+    Server s(packages, socket_path);
+    const std::string second = frame(2, Server::OP_FILES, foo32);
+    std::vector<char> in = bytes(frame(1, Server::OP_FILES, foo64) +
+                                 second.substr(0, 2));
+    std::string out;
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    BOOST_CHECK_EQUAL(parse(out).size(), 1u);
+    BOOST_CHECK_EQUAL(in.size(), 2u);
+
+    in.insert(in.end(), second.begin() + 2, second.begin() + 9);
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    BOOST_CHECK_EQUAL(parse(out).size(), 1u);
+    BOOST_CHECK_EQUAL(in.size(), 9u);
+
+    in.insert(in.end(), second.begin() + 9, second.end());
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    BOOST_CHECK(in.empty());
+    const std::vector<Reply> r = parse(out);
+    BOOST_REQUIRE_EQUAL(r.size(), 2u);
+    BOOST_CHECK_EQUAL(r[1].id, 2u);
+    BOOST_CHECK_EQUAL(r[1].status, Server::STATUS_OK);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_frames)
+{
+    Server s(packages, socket_path);
+    for (boost::uint32_t len: {0u, 1u, 4u, Server::max_request_size + 1}) {
+        std::string f;
+        put_u32(f, len);
+        std::vector<char> in = bytes(f);
+        std::string out;
+        BOOST_CHECK_MESSAGE(!s.process(in, out, no_limit),
+                            "frame of " << len << " bytes was accepted");
+        BOOST_CHECK(out.empty());
+    }
+
+    // Frames long enough for an id and an op but not for their arguments.
+    std::string f;
+    put_u32(f, 5);
+    put_u32(f, 7);
+    f.push_back(Server::OP_FILES);
+    std::string g;
+    put_u32(g, 8);
+    put_u32(g, 8);
+    g += std::string("\x02\x00\x10x", 4);
+    std::vector<char> in = bytes(f + g);
+    std::string out;
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    const std::vector<Reply> r = parse(out);
+    BOOST_REQUIRE_EQUAL(r.size(), 2u);
+    BOOST_CHECK_EQUAL(r[0].id, 7u);
+    BOOST_CHECK_EQUAL(r[0].status, Server::STATUS_BAD_REQUEST);
+    BOOST_CHECK_EQUAL(r[1].id, 8u);
+    BOOST_CHECK_EQUAL(r[1].status, Server::STATUS_BAD_REQUEST);
+}
+
+BOOST_AUTO_TEST_CASE(short_request)
+{
+    Server s(packages, socket_path);
+    const char req[] = {0, 0, 0, 9};
+    for (std::size_t size = 0; size < 5; size++) {
+        std::string out;
+        s.handle(req, size, out);
+        const std::vector<Reply> r = parse(out);
+        BOOST_REQUIRE_EQUAL(r.size(), 1u);
+        BOOST_CHECK_EQUAL(r[0].id, size >= 4 ? 9u : 0u);
+        BOOST_CHECK_EQUAL(r[0].status, Server::STATUS_BAD_REQUEST);
+        BOOST_CHECK(r[0].payload.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unknown_requests)
+{
+    Server s(packages, socket_path);
+    std::vector<char> in = bytes(
+        frame(1, 99, foo64) +
+        frame(2, Server::OP_FILES, "foo") +
+        frame(3, Server::OP_FILES, "foo-1.0-1.ppc64le") +
+        frame(4, Server::OP_TAG, foo64, tag_arg(9999)) +
+        frame(5, Server::OP_TAG, foo64, "xx") +
+        frame(6, Server::OP_STAT, foo64, "/usr/bin/bar") +
+        frame(7, Server::OP_FILES, foo64, "junk"));
+    std::string out;
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    const std::vector<Reply> r = parse(out);
+    const unsigned int expected[] = {
+        Server::STATUS_BAD_REQUEST, Server::STATUS_NOT_FOUND,
+        Server::STATUS_NOT_FOUND, Server::STATUS_NOT_FOUND,
+        Server::STATUS_BAD_REQUEST, Server::STATUS_NOT_FOUND,
+        Server::STATUS_BAD_REQUEST
+    };
+    BOOST_REQUIRE_EQUAL(r.size(), sizeof expected / sizeof expected[0]);
+    for (std::size_t i = 0; i < r.size(); i++) {
+        BOOST_CHECK_EQUAL(r[i].id, i + 1);
+        BOOST_CHECK_EQUAL(r[i].status, expected[i]);
+        BOOST_CHECK(r[i].payload.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(output_limit)
+{
+    Server s(packages, socket_path);
+    std::string reqs;
+    for (boost::uint32_t i = 0; i < 10; i++)
+        reqs += frame(i, Server::OP_FILES, foo64);
+    std::vector<char> in = bytes(reqs);
+    std::string out;
+    BOOST_REQUIRE(s.process(in, out, 1));
+    BOOST_CHECK_EQUAL(parse(out).size(), 1u);
+    BOOST_CHECK_EQUAL(in.size(), reqs.size() / 10 * 9);
+
+    // Nothing more is answered until the output drains below the limit.
+    BOOST_REQUIRE(s.process(in, out, out.size()));
+    BOOST_CHECK_EQUAL(parse(out).size(), 1u);
+    BOOST_REQUIRE(s.process(in, out, out.size() + 1));
+    BOOST_CHECK_EQUAL(parse(out).size(), 2u);
+    BOOST_REQUIRE(s.process(in, out, no_limit));
+    BOOST_CHECK_EQUAL(parse(out).size(), 10u);
+    BOOST_CHECK(in.empty());
+}
+
+BOOST_AUTO_TEST_CASE(socket_in_use)
+{
+    {
+        Server a(packages, socket_path);
+        BOOST_CHECK_THROW(Server b(packages, socket_path), std::system_error);
+        BOOST_CHECK(exists(socket_path));
+    }
+    BOOST_CHECK(!exists(socket_path));
+}
+
+BOOST_AUTO_TEST_CASE(stale_socket)
+{
+    // A socket file left behind by a server that is gone.
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socket_address(socket_path);
+    BOOST_REQUIRE_EQUAL(::bind(fd, reinterpret_cast<sockaddr *>(&addr),
+                               sizeof addr), 0);
+    ::close(fd);
+    BOOST_REQUIRE(exists(socket_path));
+    {
+        Server s(packages, socket_path);
+    }
+    BOOST_CHECK(!exists(socket_path));
+}
+
+BOOST_AUTO_TEST_CASE(socket_not_a_socket)
+{
+    TempFile f("");
+    BOOST_CHECK_THROW(Server s(packages, f.path()), std::system_error);
+    BOOST_CHECK(exists(f.path()));
+}
+
+BOOST_AUTO_TEST_CASE(replaced_socket_is_kept)
+{
+    {
+        Server s(packages, socket_path);
+        ::unlink(socket_path.c_str());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = socket_address(socket_path);
+        BOOST_REQUIRE_EQUAL(::bind(fd, reinterpret_cast<sockaddr *>(&addr),
+                                   sizeof addr), 0);
+        ::close(fd);
+    }
+    BOOST_CHECK(exists(socket_path));
+}
+
+// Runs a real server: a client pipelines more replies than the output
+// limit, half-closes and must still get all of them; SIGTERM then stops
+// the server, which removes its socket.
+BOOST_AUTO_TEST_CASE(half_close_and_stop)
+{
+    const pid_t pid = ::fork();
+    BOOST_REQUIRE_GE(pid, 0);
+    if (pid == 0) {
+        int status = 0;
+        try {
+            Server s(packages, socket_path);
+            s.run();
+        } catch (...) {
+            status = 1;
+        }
+        ::_exit(status);
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socket_address(socket_path);
+    bool connected = false;
+    for (int i = 0; i < 500 && !connected; i++) {
+        connected = ::connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                              sizeof addr) == 0;
+        if (!connected)
+            ::usleep(10000);
+    }
+    BOOST_REQUIRE(connected);
+
+    const std::size_t count = 20;
+    std::string reqs;
+    for (boost::uint32_t i = 0; i < count; i++)
+        reqs += frame(i, Server::OP_FILES, big);
+    BOOST_REQUIRE_EQUAL(::write(fd, reqs.data(), reqs.size()),
+                        ssize_t(reqs.size()));
+    ::shutdown(fd, SHUT_WR);
+    std::string out;
+    char buf[0x10000];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        out.append(buf, n);
+    ::close(fd);
+
+    const std::vector<Reply> r = parse(out);
+    BOOST_REQUIRE_EQUAL(r.size(), count);
+    for (std::size_t i = 0; i < count; i++) {
+        BOOST_CHECK_EQUAL(r[i].id, i);
+        BOOST_CHECK_EQUAL(r[i].status, Server::STATUS_OK);
+        BOOST_CHECK_EQUAL(get_u32(r[i].payload, 0), big_files);
+    }
+    BOOST_CHECK_GT(out.size(), std::size_t(0x400000));
+
+    ::kill(pid, SIGTERM);
+    int status;
+    BOOST_REQUIRE_EQUAL(::waitpid(pid, &status, 0), pid);
+    BOOST_CHECK(WIFEXITED(status));
+    BOOST_CHECK_EQUAL(WEXITSTATUS(status), 0);
+    BOOST_CHECK(!exists(socket_path));
+}
+
+BOOST_AUTO_TEST_SUITE_END()